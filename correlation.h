@@ -0,0 +1,329 @@
+#pragma once
+#include <fft.h>
+#include <world.h>
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Spatial correlations of a spin configuration s on a periodic lattice of
+// N = rows * cols sites:
+//   the structure factor S(k) = |sum_x s(x) exp(-i k.x)|^2 / N,
+//   the radially averaged connected correlation function
+//     G(r) = <s(x) s(x + r)> - m^2,   with r the (minimum image) distance,
+//   the length 2 pi / <|k|>, with <|k|> the mean of |k| weighted by S(k)
+//   over all k != 0,
+//   and the domain length, where G(r) has dropped to half of G(0), which
+//   measures the typical domain size while coarsening after a quench.
+// Both lengths average over many modes, so one snapshot gives a usable
+// value. The second moment correlation length
+//     xi = sqrt(<S(0)> / <S(k_min)> - 1) / (2 sin(k_min / 2))
+// does not: it needs the averages of S(0) and S(k_min) over many snapshots,
+// which is why those are returned rather than xi.
+// S(k) and G(r) are computed with real-to-complex FFTs in O(N log N).
+struct Correlation
+{
+    uint32_t rows;
+    uint32_t cols;
+    uint64_t generation;  // when the snapshot was taken (set by the caller)
+    double temp;
+    double magnetization;
+    // S(k) for k = 2 pi (i / rows, j / cols), i < rows, j <= cols / 2,
+    // stored row major; the other half follows from S(-k) = S(k).
+    std::vector<double> structure_factor;
+    // G(r) averaged over the bins round(|r|) = 0, 1, ..., min(rows, cols) / 2
+    std::vector<double> radial;
+    double s_zero;        // S(0) = N m^2
+    double s_kmin;        // mean S(k) over the k != 0 of smallest |k|
+    double k_min;         // that |k|, 2 pi / max(rows, cols)
+    double wave_length;   // 2 pi / <|k|>
+    double domain_length;
+
+    uint32_t spectrum_cols() const { return cols / 2 + 1; }
+    double S(uint32_t i, uint32_t j) const { return structure_factor[i * spectrum_cols() + j]; }
+};
+
+inline uint32_t radial_bins(uint32_t rows, uint32_t cols)
+{
+    return std::min(rows, cols) / 2 + 1;
+}
+
+// Computes S(k), G(r) and the derived quantities of the row major spins.
+inline Correlation measure_correlation(const int8_t* spins, uint32_t rows, uint32_t cols)
+{
+    typedef std::complex<double> cplx;
+    const uint32_t H = cols / 2 + 1;
+    const double N = double(rows) * cols;
+
+    Correlation result;
+    result.rows = rows;
+    result.cols = cols;
+    result.generation = 0;
+    result.temp = 0;
+    result.magnetization = std::accumulate(spins, spins + rows * cols, 0.) / N;
+
+    FFT row_fft(cols);
+    FFT col_fft(rows);
+    std::vector<cplx> spectrum(rows * H);
+    std::vector<cplx> row(cols);
+    std::vector<cplx> col(rows);
+
+    // Real-to-complex transform of the rows, two at a time: the transform Z
+    // of z = x + iy gives X_k = (Z_k + Z*_-k) / 2 and Y_k = (Z_k - Z*_-k) / 2i.
+    for (uint32_t r = 0; r < rows; r += 2)
+    {
+        bool pair = r + 1 < rows;
+        for (uint32_t c = 0; c < cols; c++)
+        {
+            row[c] = cplx(spins[r * cols + c], pair ? spins[(r + 1) * cols + c] : 0);
+        }
+        row_fft.transform(&row[0]);
+        for (uint32_t k = 0; k < H; k++)
+        {
+            cplx z = row[k];
+            cplx z_conj = std::conj(row[(cols - k) % cols]);
+            spectrum[r * H + k] = (z + z_conj) * 0.5;
+            if (pair)
+            {
+                spectrum[(r + 1) * H + k] = (z - z_conj) * cplx(0, -0.5);
+            }
+        }
+    }
+    // Complex transform of the remaining half of the columns
+    for (uint32_t k = 0; k < H; k++)
+    {
+        for (uint32_t r = 0; r < rows; r++)
+        {
+            col[r] = spectrum[r * H + k];
+        }
+        col_fft.transform(&col[0]);
+        for (uint32_t r = 0; r < rows; r++)
+        {
+            spectrum[r * H + k] = col[r];
+        }
+    }
+
+    result.structure_factor.resize(rows * H);
+    for (uint32_t i = 0; i < rows * H; i++)
+    {
+        result.structure_factor[i] = std::norm(spectrum[i]) / N;
+    }
+
+    // Back transform of S(k), which gives N <s(x) s(x + r)>. S is real and
+    // even, so the columns stay Hermitian and the rows can be completed with
+    // S(-k) = S(k) and transformed two at a time again.
+    for (uint32_t k = 0; k < H; k++)
+    {
+        for (uint32_t r = 0; r < rows; r++)
+        {
+            col[r] = result.structure_factor[r * H + k];
+        }
+        col_fft.transform(&col[0], true);
+        for (uint32_t r = 0; r < rows; r++)
+        {
+            spectrum[r * H + k] = col[r];
+        }
+    }
+    std::vector<double> correlation(rows * cols);
+    for (uint32_t r = 0; r < rows; r += 2)
+    {
+        bool pair = r + 1 < rows;
+        for (uint32_t c = 0; c < cols; c++)
+        {
+            cplx x = c < H ? spectrum[r * H + c] : std::conj(spectrum[r * H + cols - c]);
+            cplx y = !pair ? 0 : c < H ? spectrum[(r + 1) * H + c]
+                                       : std::conj(spectrum[(r + 1) * H + cols - c]);
+            row[c] = x + cplx(0, 1) * y;
+        }
+        row_fft.transform(&row[0], true);
+        for (uint32_t c = 0; c < cols; c++)
+        {
+            correlation[r * cols + c] = row[c].real() / N;
+            if (pair)
+            {
+                correlation[(r + 1) * cols + c] = row[c].imag() / N;
+            }
+        }
+    }
+
+    // Radial average of the connected correlation function
+    uint32_t bins = radial_bins(rows, cols);
+    double m2 = result.magnetization * result.magnetization;
+    std::vector<double> sums(bins, 0.);
+    std::vector<uint32_t> counts(bins, 0);
+    for (uint32_t r = 0; r < rows; r++)
+    {
+        double dr = std::min(r, rows - r);
+        for (uint32_t c = 0; c < cols; c++)
+        {
+            double dc = std::min(c, cols - c);
+            uint32_t bin = uint32_t(std::sqrt(dr * dr + dc * dc) + 0.5);
+            if (bin < bins)
+            {
+                sums[bin] += correlation[r * cols + c] - m2;
+                counts[bin]++;
+            }
+        }
+    }
+    result.radial.resize(bins);
+    for (uint32_t b = 0; b < bins; b++)
+    {
+        result.radial[b] = counts[b] ? sums[b] / counts[b] : 0;
+    }
+
+    // The smallest nonzero wave vectors lie along the longest side: the
+    // (up to four) modes (+-1, 0) and (0, +-1), with S(-k) = S(k).
+    uint32_t length = std::max(rows, cols);
+    result.s_zero = result.S(0, 0);
+    result.k_min = length > 1 ? 2 * M_PI / length : 0;
+    result.s_kmin = 0;
+    if (length > 1)
+    {
+        double sum = 0;
+        int modes = 0;
+        if (rows == length)
+        {
+            sum += result.S(1, 0) + result.S(rows - 1, 0);
+            modes += 2;
+        }
+        if (cols == length)
+        {
+            sum += 2 * result.S(0, 1);
+            modes += 2;
+        }
+        result.s_kmin = sum / modes;
+    }
+
+    // Mean |k| over the full spectrum; the columns 0 < j < cols / 2 stand
+    // for two wave vectors each.
+    double s_sum = 0;
+    double k_sum = 0;
+    for (uint32_t i = 0; i < rows; i++)
+    {
+        double ki = 2 * M_PI * std::min(i, rows - i) / rows;
+        for (uint32_t j = 0; j < H; j++)
+        {
+            if (i == 0 and j == 0)
+            {
+                continue;
+            }
+            double kj = 2 * M_PI * j / cols;
+            double weight = (j == 0 or 2 * j == cols) ? 1 : 2;
+            s_sum += weight * result.S(i, j);
+            k_sum += weight * result.S(i, j) * std::sqrt(ki * ki + kj * kj);
+        }
+    }
+    result.wave_length = k_sum > 0 ? 2 * M_PI * s_sum / k_sum : 0;
+
+    // Crossing of G(0) / 2, linearly interpolated. (The first zero of G(r)
+    // would be the alternative, but it is much noisier.)
+    result.domain_length = 0;
+    double half = result.radial[0] / 2;
+    for (uint32_t b = 1; b < bins; b++)
+    {
+        if (result.radial[b] <= half)
+        {
+            double g0 = result.radial[b - 1];
+            double g1 = result.radial[b];
+            result.domain_length = (b - 1) + (g0 > g1 ? (g0 - half) / (g0 - g1) : 0);
+            break;
+        }
+    }
+    return result;
+}
+
+// Measures correlations on a worker thread from a snapshot of a World, so
+// that the sweeps are not blocked. At most one measurement runs at a time.
+class CorrelationWorker
+{
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool busy_;     // a snapshot is pending or being measured
+    bool done_;     // result_ has not been collected yet
+    bool stop_;
+    std::vector<int8_t> snapshot_;
+    uint32_t rows_;
+    uint32_t cols_;
+    uint64_t generation_;
+    double temp_;
+    Correlation result_;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            wake_.wait(lock, [this]() { return stop_ or (busy_ and not done_); });
+            if (stop_)
+            {
+                return;
+            }
+            lock.unlock();
+            // snapshot_ is not touched by submit() while busy_
+            Correlation result = measure_correlation(&snapshot_[0], rows_, cols_);
+            result.generation = generation_;
+            result.temp = temp_;
+            lock.lock();
+            result_ = std::move(result);
+            done_ = true;
+            busy_ = false;
+        }
+    }
+
+public:
+    CorrelationWorker()
+            : busy_(false), done_(false), stop_(false), rows_(0), cols_(0),
+              generation_(0), temp_(0)
+    {
+        thread_ = std::thread(&CorrelationWorker::run, this);
+    }
+
+    ~CorrelationWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    // Copies the current state of world for measurement. Returns false,
+    // without waiting, if the previous measurement is still in progress or
+    // its result has not been collected.
+    bool submit(const World& world, uint64_t generation)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (busy_ or done_)
+            {
+                return false;
+            }
+            rows_ = world.getRows();
+            cols_ = world.getCols();
+            snapshot_.assign(std::begin(world.data()), std::end(world.data()));
+            generation_ = generation;
+            temp_ = world.get_temp();
+            busy_ = true;
+        }
+        wake_.notify_one();
+        return true;
+    }
+
+    // Moves a finished result into out. Returns false if there is none.
+    bool poll(Correlation& out)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (not done_)
+        {
+            return false;
+        }
+        out = std::move(result_);
+        done_ = false;
+        return true;
+    }
+};
@@ -0,0 +1,148 @@
+#pragma once
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+
+// Discrete Fourier transform of a fixed length n,
+//     X_k = sum_j x_j exp(-2 pi i jk / n)    (forward)
+//     x_j = sum_k X_k exp(2 pi i jk / n)     (inverse, not normalized)
+// Powers of two use an iterative radix 2 transform, other lengths (e.g. the
+// size of a terminal) are reduced to one via Bluestein's chirp z-transform.
+class FFT
+{
+    typedef std::complex<double> cplx;
+
+    uint32_t n_;
+    uint32_t m_;                         // radix 2 length actually transformed
+    std::vector<uint32_t> reversed_;     // bit reversal permutation of 0..m_-1
+    std::vector<cplx> twiddles_;         // exp(-2 pi i k / m_), k < m_/2
+    std::vector<cplx> chirp_;            // Bluestein: exp(-pi i k^2 / n_)
+    std::vector<cplx> chirp_filter_;     // Bluestein: transform of conj(chirp)
+    std::vector<cplx> work_;
+
+    static bool is_power_of_two(uint32_t n) { return (n & (n - 1)) == 0; }
+
+    void radix2(cplx* x, bool inverse) const
+    {
+        for (uint32_t i = 0; i < m_; i++)
+        {
+            if (i < reversed_[i])
+            {
+                std::swap(x[i], x[reversed_[i]]);
+            }
+        }
+        for (uint32_t len = 2; len <= m_; len *= 2)
+        {
+            uint32_t half = len / 2;
+            uint32_t step = m_ / len;
+            for (uint32_t start = 0; start < m_; start += len)
+            {
+                for (uint32_t k = 0; k < half; k++)
+                {
+                    cplx w = inverse ? std::conj(twiddles_[k * step]) : twiddles_[k * step];
+                    cplx u = x[start + k];
+                    cplx v = x[start + k + half] * w;
+                    x[start + k] = u + v;
+                    x[start + k + half] = u - v;
+                }
+            }
+        }
+    }
+
+public:
+    explicit FFT(uint32_t n)
+            : n_(n), m_(1)
+    {
+        if (n_ == 0)
+        {
+            return;
+        }
+        if (is_power_of_two(n_))
+        {
+            m_ = n_;
+        }
+        else
+        {
+            while (m_ < 2 * n_ - 1)
+            {
+                m_ *= 2;
+            }
+        }
+
+        reversed_.resize(m_);
+        uint32_t bits = 0;
+        while ((1u << bits) < m_)
+        {
+            bits++;
+        }
+        for (uint32_t i = 0; i < m_; i++)
+        {
+            uint32_t r = 0;
+            for (uint32_t b = 0; b < bits; b++)
+            {
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            }
+            reversed_[i] = r;
+        }
+        twiddles_.resize(m_ / 2);
+        for (uint32_t k = 0; k < m_ / 2; k++)
+        {
+            twiddles_[k] = std::polar(1.0, -2 * M_PI * k / m_);
+        }
+
+        if (m_ != n_)
+        {
+            chirp_.resize(n_);
+            for (uint64_t k = 0; k < n_; k++)
+            {
+                // k^2 modulo 2n keeps the argument small and precise
+                chirp_[k] = std::polar(1.0, -M_PI * double(k * k % (2 * n_)) / n_);
+            }
+            chirp_filter_.assign(m_, 0.);
+            chirp_filter_[0] = std::conj(chirp_[0]);
+            for (uint32_t k = 1; k < n_; k++)
+            {
+                chirp_filter_[k] = chirp_filter_[m_ - k] = std::conj(chirp_[k]);
+            }
+            radix2(&chirp_filter_[0], false);
+            work_.resize(m_);
+        }
+    }
+
+    uint32_t size() const { return n_; }
+
+    // Transforms the n values at x in place.
+    void transform(cplx* x, bool inverse=false)
+    {
+        if (n_ == 0)
+        {
+            return;
+        }
+        if (m_ == n_)
+        {
+            radix2(x, inverse);
+            return;
+        }
+        // The inverse transform is the conjugate of the forward transform of
+        // the conjugate.
+        for (uint32_t k = 0; k < n_; k++)
+        {
+            work_[k] = (inverse ? std::conj(x[k]) : x[k]) * chirp_[k];
+        }
+        std::fill(work_.begin() + n_, work_.end(), cplx(0.));
+        radix2(&work_[0], false);
+        for (uint32_t k = 0; k < m_; k++)
+        {
+            work_[k] *= chirp_filter_[k];
+        }
+        radix2(&work_[0], true);
+        for (uint32_t k = 0; k < n_; k++)
+        {
+            cplx y = work_[k] * chirp_[k] / double(m_);
+            x[k] = inverse ? std::conj(y) : y;
+        }
+    }
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include <world.h>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+
+// Joint histogram of the total energy E and magnetization M sampled at a
+// fixed temperature, for Ferrenberg-Swendsen reweighting (see reweight.cpp).
+// Only the visited (E, M) pairs are stored, which is a small fraction of the
+// O(N^2) possible ones.
+//
+// File format: a header line
+//     # histogram rows <rows> cols <cols> temp <temp> samples <samples>
+// followed by one line "<E> <M> <count>" per visited pair.
+class EMHistogram
+{
+public:
+    typedef std::pair<int64_t, int64_t> Key; // (E, M)
+    typedef std::map<Key, uint64_t> Counts;
+
+private:
+    uint32_t rows_;
+    uint32_t cols_;
+    double temp_;
+    uint64_t samples_;
+    Counts counts_;
+
+public:
+    EMHistogram(uint32_t rows=0, uint32_t cols=0, double temp=1.0)
+            : rows_(rows), cols_(cols), temp_(temp), samples_(0) {}
+
+    uint32_t getRows() const { return rows_; }
+    uint32_t getCols() const { return cols_; }
+    double get_temp() const { return temp_; }
+    uint64_t samples() const { return samples_; }
+    const Counts& counts() const { return counts_; }
+
+    // Start over, e.g. after a change of temperature
+    void reset(double temp)
+    {
+        temp_ = temp;
+        samples_ = 0;
+        counts_.clear();
+    }
+
+    void add(int64_t energy, int64_t magnetization)
+    {
+        counts_[Key(energy, magnetization)]++;
+        samples_++;
+    }
+
+    // Sample the current state of the world
+    void add(const World& world)
+    {
+        add(world.energy(), world.magnetization());
+    }
+
+    bool save(const std::string& filename) const
+    {
+        std::ofstream file(filename);
+        file << "# histogram rows " << rows_ << " cols " << cols_
+             << " temp " << std::setprecision(std::numeric_limits<double>::max_digits10)
+             << temp_ << " samples " << samples_ << '\n';
+        for (auto& entry : counts_)
+        {
+            file << entry.first.first << ' ' << entry.first.second << ' '
+                 << entry.second << '\n';
+        }
+        file.close();
+        return bool(file);
+    }
+
+    // Returns false if the file cannot be read or is not a histogram.
+    bool load(const std::string& filename)
+    {
+        std::ifstream file(filename);
+        std::string hash, tag, rows, cols, temp, samples;
+        file >> hash >> tag >> rows >> rows_ >> cols >> cols_
+             >> temp >> temp_ >> samples >> samples_;
+        if (not file or hash != "#" or tag != "histogram")
+        {
+            return false;
+        }
+        counts_.clear();
+        int64_t energy, magnetization;
+        uint64_t count;
+        uint64_t total = 0;
+        while (file >> energy >> magnetization >> count)
+        {
+            counts_[Key(energy, magnetization)] += count;
+            total += count;
+        }
+        return file.eof() and total == samples_;
+    }
+};
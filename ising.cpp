@@ -1,6 +1,8 @@
-// g++ --std=c++14 -I. -o ising -O3 ising.cpp # or clang++
-#include <matrix.h>
-#include <random>
+// g++ --std=c++14 -pthread -I. -o ising -O3 ising.cpp # or clang++
+#include <world.h>
+#include <correlation.h>
+#include <histogram.h>
+#include <parallel_wolff.h>
 #include <iostream>
 #include <chrono>
 #include <thread>
@@ -12,202 +14,6 @@
 #include <algorithm>
 using namespace std;
 
-class World: public Matrix
-{
-    double beta_;
-    mt19937 generator_;
-    mt19937 generator2_;
-    uniform_int_distribution<uint32_t> row_picker_;
-    uniform_int_distribution<uint32_t> col_picker_;
-    uniform_real_distribution<double> dist_;
-    function<double()> rnd;
-    function<uint32_t()> rnd_row;
-    function<uint32_t()> rnd_col;
-    
-    struct Point
-    {
-        uint32_t row;
-        uint32_t col;
-    };
-
-    struct point_hash {
-        size_t operator()(const Point& p) const {
-            return p.row*31 + p.col;
-        }
-    };
-
-    struct point_equal {
-        bool operator()(const Point& p, const Point& q) const {
-            return p.row == q.row and p.col == q.col;
-        }
-    };
-
-    struct Neighbours
-    {
-        const World& world;
-        vector<Point> points;
-        Neighbours(const World& world, const Point& point)
-                : world(world)
-        {
-            auto row = point.row;
-            auto col = point.col;
-            auto R = world.getRows();
-            auto C = world.getCols();
-            points = {Point{(row + 1) % R, col},
-                      Point{(row - 1 + R) % R, col},
-                      Point{row, (col + 1) % C},
-                      Point{row, (col - 1 + C) % C}};
-        }
-    };
-    
-public:
-    using Matrix::Matrix; // c++11: matrix constructors
-    World(uint32_t rows, uint32_t cols, double temp=1.0, int seed=0)
-            : Matrix(rows, cols), beta_(1./temp),
-              generator_(), generator2_(),
-              row_picker_(0, rows - 1), col_picker_(0, cols - 1), dist_()
-    {
-        generator_.seed(seed);
-        generator2_.seed(seed + 1);
-        rnd = bind(dist_, generator_);
-        rnd_row = bind(row_picker_, generator_);
-        rnd_col = bind(col_picker_, generator2_);
-    }
-
-    int8_t getp(Point p) const
-    {
-        return get(p.row, p.col);
-    }
-    
-    void setp(Point p, int8_t val)
-    {
-        set(p.row, p.col, val);
-    }
-    
-    void init(double fraction, int seed=0)
-    {
-        bernoulli_distribution dist(fraction);
-        generator_.seed(seed);
-        auto rnd_init = bind(dist, generator_);
-        generate(begin(data()), end(data()), [&rnd_init]() { return rnd_init() ? 1 : -1; });
-    }
-
-    void set_temp(double temp)
-    {
-        beta_ = 1./temp;
-    }
-
-    double get_temp() const
-    {
-        return 1./beta_;
-    }
-    
-    // Average magnetization
-    double net_magnetization() const
-    {
-        // cannot use data().sum(), because the data type cannot hold the sum in general
-        return accumulate(begin(data()), end(data()), 0.) / // default operator is plus<T>
-            (getRows() * getCols());
-    }
-
-    int neighbour_sum(int row, int col) const
-    {
-        auto R = getRows();
-        auto C = getCols();
-        return get((row + 1) % R, col) +
-            get((row - 1 + R) % R, col) +
-            get(row, (col + 1) % C) +
-            get(row, (col - 1 + C) % C);
-    }
-
-    uint32_t update_metropolis(int n=1) 
-    {
-        uint32_t accepted = 0;
-        for (int i = 0; i < n; i++)
-        {
-            int row = rnd_row();
-            int col = rnd_col();
-            auto val = get(row, col);
-            double delta_E = 2 * val * neighbour_sum(row, col);
-            // printf("(%d,%d), ΔE = %.1f: ", row, col, delta_E); ///
-            // accept or reject?
-            if (rnd() < exp(-beta_ * delta_E))
-            {
-                set(row, col, -val);
-                accepted++;
-                // printf("accepted\n"); ///
-            }
-            else
-            {
-                // printf("rejected\n"); ///
-            }
-        }
-        return accepted;
-    }
-    
-    uint32_t update_wolff(int n=1)
-    {
-        for (int i = 0; i < n; i++)
-        {
-            // value for p for which rejection rate is 0: full Boltzmann 
-            // statistics are obtained from conditions for cluster growth. 
-            double p = 1.0 - exp(-2.0 * beta_);
-            Point k{rnd_row(), rnd_col()};
-            vector<Point> frontier{k};
-            unordered_set<Point, point_hash, point_equal>cluster({k});
-            while (!frontier.empty())
-            {
-                // choose random element from frontier and remove it
-                uniform_int_distribution<uint32_t> point_picker(0, frontier.size() - 1);
-                swap(frontier[point_picker(generator_)], frontier.back());
-                auto j = frontier.back();   // this is the random frontier element
-                frontier.pop_back();        // remove from frontier
-                // determine which of its neighbours to add to cluser
-                // (with probability p if it has the same spin)
-                Neighbours j_neighbours(*this, j);
-                for (auto& l : j_neighbours.points)
-                {
-                    // Could leave test that l is in cluster out. What is faster? Check
-                    if (getp(l) == getp(j) and cluster.find(l) == cluster.end() and rnd() < p)
-                    {
-                        // add l to frontier and to cluster
-                        frontier.push_back(l);
-                        cluster.emplace(l);
-                    }   
-                }
-            }
-            // flip all element of the cluster
-            for (auto& j : cluster)
-            {
-                setp(j, -getp(j));
-            }
-        }
-        return n;
-    }
-    
-    void print(const string& info) const
-    {
-        uint32_t R = getRows();
-        uint32_t C = getCols();
-        
-        for (uint32_t r = 0; r < R; r++)
-        {
-            for (uint32_t c = 0; c < C; c++)
-            {
-                putchar(get(r,c) == 1 ? 'O' : ' ');
-                //putwchar(get(r,c) == 1 ? u'↑' : u'↓');
-            }
-            if (r != R - 1)
-            {
-                putchar('\n');
-            }
-        }
-        // hide visibility cursor and put cursor at 0,0 
-        printf("%c[?25l%c[%d;%df",0x1B,0x1B,0,0); 
-        cout << info << flush;
-    }
-};
-    
 
 #include <cstdlib>
 #include <cstdio>
@@ -222,9 +28,10 @@ public:
 
 class Interaction
 {
-    enum UpdateAlgorithm {METROPOLIS, WOLFF};
+    enum UpdateAlgorithm {METROPOLIS, WOLFF, PARALLEL_WOLFF};
     
     World* world_;
+    ParallelWolff parallel_wolff_;
     unsigned char c;
     bool show_info_;
     UpdateAlgorithm algorithm_;
@@ -237,6 +44,23 @@ class Interaction
     uint32_t steps_;
     uint32_t accepted_;
 
+    // Correlation measurements run in the background on snapshots. While
+    // stats are recorded, one is requested every correlation_period_
+    // generations and its results are appended to stats_.
+    CorrelationWorker correlation_worker_;
+    uint64_t generation_;
+    uint32_t correlation_period_;
+    ofstream stats_;
+    string correlation_filename_; // pending on-demand dump of S(k) and G(r)
+    bool correlation_submitted_;
+    double wave_length_;
+    double domain_length_;
+
+    // While recording, every generation adds a sample to the (E, M)
+    // histogram, which is saved and restarted when the temperature changes.
+    EMHistogram histogram_;
+    bool record_histogram_;
+
     // Returns the leading digit of a number.
     // The factor 1.0001 ensures that this goes well up to around 3 
     // significant decimal digits
@@ -249,10 +73,14 @@ class Interaction
 public:
     enum KeyAction {EXIT, CONTINUE};
     
-    Interaction(World* world, double delay, uint32_t steps_per_generation)
-            : world_(world), c('\0'), show_info_(false), delay_(delay),
+    Interaction(World* world, double delay, uint32_t steps_per_generation, int seed=0)
+            : world_(world), parallel_wolff_(seed), c('\0'), show_info_(false),
+              algorithm_(METROPOLIS), delay_(delay),
               steps_per_generation_(steps_per_generation),
-              steps_(0), accepted_(0)
+              steps_(0), accepted_(0), generation_(0), correlation_period_(10),
+              correlation_submitted_(false), wave_length_(0), domain_length_(0),
+              histogram_(world->getRows(), world->getCols(), world->get_temp()),
+              record_histogram_(false)
     {
         tcgetattr(STDIN_FILENO, &tty_config_);
         tty_config_orig_ = tty_config_;
@@ -265,6 +93,7 @@ public:
 
     ~Interaction()
     {
+        save_histogram();
         printf("%c[?25h", 0x1b); // show cursor
         tcsetattr(STDIN_FILENO, TCSANOW, &tty_config_orig_);
     }
@@ -272,7 +101,9 @@ public:
     
     void change_temp(double factor)
     {
+        save_histogram();
         world_->set_temp(world_->get_temp() * factor);
+        histogram_.reset(world_->get_temp());
     }
 
     void raise_delay()
@@ -306,10 +137,26 @@ public:
                 steps_per_generation_ = 1000;
                 break;
             case WOLFF:
+                algorithm_ = PARALLEL_WOLFF;
+                break;
+            case PARALLEL_WOLFF:
                 algorithm_ = METROPOLIS;
                 break;
         }
     }
+
+    const char* algorithm_name() const
+    {
+        switch (algorithm_)
+        {
+            case WOLFF:
+                return "Wolff";
+            case PARALLEL_WOLFF:
+                return "Parallel-Wolff";
+            default:
+                return "Metropolis";
+        }
+    }
     
     // unused
     void change_delay(double factor)
@@ -366,7 +213,7 @@ public:
 
     uint32_t get_steps_per_generation() const
     {
-        return uint32_t(steps_per_generation_ * (algorithm_ == WOLFF ? 0.001 : 1) + .9999);
+        return uint32_t(steps_per_generation_ * (algorithm_ == METROPOLIS ? 1 : 0.001) + .9999);
     }
 
     double get_acceptance_rate() const
@@ -385,18 +232,20 @@ public:
                 "  Delay: %d ms"
                 "  Steps per generation: %d"
                 "  Acceptance rate: %.6f" 
-                "  Commands: hcfsmliwadq  ";
+                "  Length 2pi/<k>: %.2f"
+                "  Domain length: %.2f"
+                "  Commands: hcfsmliwadxgeq  ";
             int len = snprintf(nullptr, 0, format,
-                               algorithm_ == WOLFF ? "Wolff" : "Metropolis",
+                               algorithm_name(),
                                world_->get_temp(), world_->net_magnetization(),
                                get_delay(), get_steps_per_generation(),
-                               get_acceptance_rate()) + 1;
+                               get_acceptance_rate(), wave_length_, domain_length_) + 1;
             vector<char> chars(len);
             snprintf(&chars[0], chars.size(), format,
-                     algorithm_ == WOLFF ? "Wolff" : "Metropolis",
+                     algorithm_name(),
                      world_->get_temp(), world_->net_magnetization(),
                      get_delay(), get_steps_per_generation(),
-                     get_acceptance_rate());
+                     get_acceptance_rate(), wave_length_, domain_length_);
             
             return string(&chars[0]);
         }
@@ -418,10 +267,124 @@ public:
         {
             accepted_ += world_->update_wolff(get_steps_per_generation());
         }
+        else if (algorithm_ == PARALLEL_WOLFF)
+        {
+            accepted_ += parallel_wolff_.update(*world_, get_steps_per_generation());
+        }
         else if (algorithm_ == METROPOLIS)
         {
             accepted_ += world_->update_metropolis(get_steps_per_generation());
         }
+        generation_++;
+        update_correlation();
+        if (record_histogram_)
+        {
+            histogram_.add(*world_);
+        }
+    }
+
+    // Collects a finished correlation measurement, if any, and requests a
+    // new one when due. Never waits for the worker.
+    void update_correlation()
+    {
+        Correlation result;
+        if (correlation_worker_.poll(result))
+        {
+            wave_length_ = result.wave_length;
+            domain_length_ = result.domain_length;
+            if (stats_.is_open())
+            {
+                stats_ << result.generation << ' ' << result.temp << ' '
+                       << result.magnetization << ' ' << result.s_zero << ' '
+                       << result.s_kmin << ' ' << result.wave_length << ' '
+                       << result.domain_length << endl;
+            }
+            if (correlation_submitted_)
+            {
+                dump_correlation(result);
+                correlation_filename_.clear();
+                correlation_submitted_ = false;
+            }
+        }
+        bool due = stats_.is_open() and generation_ % correlation_period_ == 0;
+        bool requested = not correlation_filename_.empty() and not correlation_submitted_;
+        if ((due or requested) and correlation_worker_.submit(*world_, generation_))
+        {
+            correlation_submitted_ = requested;
+        }
+    }
+
+    // Start or stop appending the correlation measurements over time to a
+    // file. S(0) and S(k_min) of single snapshots are only meaningful as
+    // averages, see correlation.h.
+    void toggle_stats()
+    {
+        if (stats_.is_open())
+        {
+            stats_.close();
+        }
+        else
+        {
+            stats_.open(state_filename() + "-stats.txt");
+            double k_min = 2 * M_PI / max(world_->getRows(), world_->getCols());
+            stats_ << "# k_min " << k_min << ": with averages over equilibrium snapshots,"
+                   << " xi = sqrt(<S(0)> / <S(k_min)> - 1) / (2 sin(k_min / 2))" << endl;
+            stats_ << "# generation temp magnetization S(0) S(k_min) length_2pi/<k> domain_length"
+                   << endl;
+        }
+    }
+
+    void toggle_histogram()
+    {
+        if (record_histogram_)
+        {
+            save_histogram();
+        }
+        record_histogram_ = !record_histogram_;
+        histogram_.reset(world_->get_temp());
+    }
+
+    void save_histogram() const
+    {
+        if (record_histogram_ and histogram_.samples() > 0)
+        {
+            histogram_.save(state_filename() + "-hist.txt");
+        }
+    }
+
+    // Request S(k) and G(r) to be written to a file once they are measured
+    void request_correlation()
+    {
+        if (correlation_filename_.empty())
+        {
+            correlation_filename_ = state_filename() + "-corr.txt";
+        }
+    }
+
+    void dump_correlation(const Correlation& result) const
+    {
+        ofstream file(correlation_filename_);
+        file << "# generation " << result.generation << " temp " << result.temp
+             << " magnetization " << result.magnetization
+             << " S(0) " << result.s_zero << " S(k_min) " << result.s_kmin
+             << " k_min " << result.k_min
+             << " length_2pi/<k> " << result.wave_length
+             << " domain_length " << result.domain_length << endl;
+        file << "# G(r), r = 0, 1, ..." << endl;
+        for (auto g : result.radial)
+        {
+            file << g << endl;
+        }
+        file << "# S(k), k = 2 pi (row / rows, col / cols), col <= cols / 2" << endl;
+        for (uint32_t r = 0; r < result.rows; r++)
+        {
+            for (uint32_t c = 0; c < result.spectrum_cols(); c++)
+            {
+                file << result.S(r, c) << ' ';
+            }
+            file << endl;
+        }
+        file.close();
     }
     
     void sleep_for() const
@@ -434,12 +397,12 @@ public:
         auto format = "%dsteps-%s-temp%.6f";
         int len = snprintf(nullptr, 0, format,
                            steps_,
-                           algorithm_ == WOLFF ? "Wolff" : "Metropolis",
+                           algorithm_name(),
                            world_->get_temp()) + 1;
         vector<char> chars(len);
         snprintf(&chars[0], chars.size(), format,
                  steps_,
-                 algorithm_ == WOLFF ? "Wolff" : "Metropolis",
+                 algorithm_name(),
                  world_->get_temp());
             
         return string(&chars[0]);
@@ -517,6 +480,15 @@ public:
                 case 'd': // dump
                     dump_state_txt(); // dump_state_bin();
                     break;
+                case 'x': // statistics
+                    toggle_stats();
+                    break;
+                case 'g': // G(r), correlations
+                    request_correlation();
+                    break;
+                case 'e': // energy histogram
+                    toggle_histogram();
+                    break;
                 case 'q':
                     return EXIT;
             }
@@ -537,7 +509,7 @@ int main_txt(int steps_per_generation,
     m.init(fraction);
     m.print("");
 
-    Interaction interaction(&m, delay, steps_per_generation);
+    Interaction interaction(&m, delay, steps_per_generation, seed);
     
     // printf("%c[?25l\n", 0x1b); // hide cursor
 
@@ -587,7 +559,7 @@ int main_fb(int fbfd, int steps_per_generation,
     auto setter = [&green, &red](auto x){return x == 1? green : red;};
     transform(begin(m.data()), end(m.data()), fbp, setter);
 
-    Interaction interaction(&m, delay, steps_per_generation);
+    Interaction interaction(&m, delay, steps_per_generation, seed);
 
     printf("%c[?25l\n", 0x1b); // hide cursor
     
@@ -0,0 +1,202 @@
+// Implementation of the C interface declared in ising_api.h.
+#include <ising_api.h>
+#include <world.h>
+#include <correlation.h>
+#include <histogram.h>
+#include <parallel_wolff.h>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <new>
+#include <system_error>
+
+struct ising_world
+{
+    World world;
+    EMHistogram histogram;
+    int seed;
+    std::unique_ptr<ParallelWolff> parallel_wolff; // created on first use
+    ising_world(uint32_t rows, uint32_t cols, double temp, int seed)
+            : world(rows, cols, temp, seed), histogram(rows, cols, temp), seed(seed) {}
+};
+
+extern "C" {
+
+int ising_api_version(void)
+{
+    return ISING_API_VERSION;
+}
+
+ising_world* ising_create(uint32_t rows, uint32_t cols, double temp, int seed)
+{
+    if (rows == 0 or cols == 0)
+    {
+        return nullptr;
+    }
+    // No exception may cross the C boundary.
+    try
+    {
+        return new ising_world(rows, cols, temp, seed);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+void ising_destroy(ising_world* world)
+{
+    delete world;
+}
+
+void ising_init(ising_world* world, double fraction, int seed)
+{
+    world->world.init(fraction, seed);
+}
+
+uint32_t ising_rows(const ising_world* world)
+{
+    return world->world.getRows();
+}
+
+uint32_t ising_cols(const ising_world* world)
+{
+    return world->world.getCols();
+}
+
+int8_t* ising_data(ising_world* world)
+{
+    return &world->world.data()[0];
+}
+
+int ising_set_temp(ising_world* world, double temp)
+{
+    if (world->world.same_temp(temp))
+    {
+        return 1;
+    }
+    if (world->histogram.samples() > 0)
+    {
+        return 0;
+    }
+    world->world.set_temp(temp);
+    world->histogram.reset(world->world.get_temp());
+    return 1;
+}
+
+double ising_get_temp(const ising_world* world)
+{
+    return world->world.get_temp();
+}
+
+double ising_net_magnetization(const ising_world* world)
+{
+    return world->world.net_magnetization();
+}
+
+int64_t ising_magnetization(const ising_world* world)
+{
+    return world->world.magnetization();
+}
+
+int64_t ising_energy(const ising_world* world)
+{
+    return world->world.energy();
+}
+
+uint32_t ising_update_metropolis(ising_world* world, uint32_t n)
+{
+    return world->world.update_metropolis(n);
+}
+
+uint32_t ising_update_wolff(ising_world* world, uint32_t n)
+{
+    return world->world.update_wolff(n);
+}
+
+int64_t ising_update_wolff_parallel(ising_world* world, uint32_t n, unsigned threads)
+{
+    unsigned hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads == 0 ? hardware_threads : threads, 4 * hardware_threads);
+    // No exception may cross the C boundary.
+    try
+    {
+        if (not world->parallel_wolff)
+        {
+            world->parallel_wolff.reset(new ParallelWolff(world->seed, threads));
+        }
+        else
+        {
+            world->parallel_wolff->set_threads(threads);
+        }
+    }
+    catch (const std::system_error&)
+    {
+        return ISING_NO_THREADS;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return 0;
+    }
+    try
+    {
+        return world->parallel_wolff->update(world->world, n);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return 0; // no memory for the visited marks; nothing was updated
+    }
+}
+
+uint32_t ising_radial_bins(const ising_world* world)
+{
+    return radial_bins(world->world.getRows(), world->world.getCols());
+}
+
+double ising_correlation(const ising_world* world, double* structure_factor,
+                         double* radial, double* domain_length)
+{
+    Correlation result;
+    try
+    {
+        result = measure_correlation(&world->world.data()[0],
+                                     world->world.getRows(),
+                                     world->world.getCols());
+    }
+    catch (const std::bad_alloc&)
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    if (structure_factor)
+    {
+        std::copy(result.structure_factor.begin(), result.structure_factor.end(),
+                  structure_factor);
+    }
+    if (radial)
+    {
+        std::copy(result.radial.begin(), result.radial.end(), radial);
+    }
+    if (domain_length)
+    {
+        *domain_length = result.domain_length;
+    }
+    return result.wave_length;
+}
+
+void ising_histogram_reset(ising_world* world)
+{
+    world->histogram.reset(world->world.get_temp());
+}
+
+uint64_t ising_histogram_sample(ising_world* world)
+{
+    world->histogram.add(world->world);
+    return world->histogram.samples();
+}
+
+int ising_histogram_save(const ising_world* world, const char* filename)
+{
+    return world->histogram.save(filename);
+}
+
+} // extern "C"
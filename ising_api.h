@@ -0,0 +1,83 @@
+/* Stable C interface to the Ising simulation engine (libising.so).
+ *
+ * A world is handled through an opaque pointer. The spins are stored row
+ * major as one int8_t (-1 or 1) per site; the pointer returned by
+ * ising_data() stays valid, and is updated in place, until the world is
+ * destroyed, so it can be wrapped without copying (see pyising.py).
+ */
+#ifndef ISING_API_H
+#define ISING_API_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ISING_API_VERSION 7
+
+typedef struct ising_world ising_world;
+
+int ising_api_version(void);
+
+/* Returns NULL if the world could not be allocated. */
+ising_world* ising_create(uint32_t rows, uint32_t cols, double temp, int seed);
+void ising_destroy(ising_world* world);
+
+/* Set every spin to 1 with probability fraction, to -1 otherwise. */
+void ising_init(ising_world* world, double fraction, int seed);
+
+uint32_t ising_rows(const ising_world* world);
+uint32_t ising_cols(const ising_world* world);
+int8_t* ising_data(ising_world* world);
+
+/* Returns 0, and leaves the temperature unchanged, if the histogram holds
+ * samples (see below). */
+int ising_set_temp(ising_world* world, double temp);
+double ising_get_temp(const ising_world* world);
+double ising_net_magnetization(const ising_world* world);
+/* Totals: M is the sum of the spins, E = -sum of s_i s_j over neighbours. */
+int64_t ising_magnetization(const ising_world* world);
+int64_t ising_energy(const ising_world* world);
+
+/* Both return the number of accepted updates (clusters for Wolff). */
+uint32_t ising_update_metropolis(ising_world* world, uint32_t n);
+uint32_t ising_update_wolff(ising_world* world, uint32_t n);
+/* Wolff updates with large clusters grown and flipped by several threads
+ * (see parallel_wolff.h); threads == 0 uses all hardware threads, and at
+ * most 4 times that many are used. Returns the number of clusters flipped,
+ * which is less than n only if memory ran out, or ISING_NO_THREADS, without
+ * updating, if the threads could not be started. */
+#define ISING_NO_THREADS (-1)
+int64_t ising_update_wolff_parallel(ising_world* world, uint32_t n, unsigned threads);
+
+/* Spatial correlations of the current state, computed with FFTs (see
+ * correlation.h). structure_factor receives S(k) for the rows * (cols/2 + 1)
+ * wave vectors k = 2 pi (i/rows, j/cols), j <= cols/2, row major, and
+ * radial the connected correlation function G(r) for the
+ * ising_radial_bins() distances r = 0, 1, ...; either may be NULL.
+ * Returns the length 2 pi / <|k|>, with <|k|> weighted by S(k); the domain
+ * length (where G(r) drops to G(0)/2) is stored in domain_length unless it
+ * is NULL. The second moment correlation length needs S(0) and S(k_min)
+ * averaged over many states; see correlation.h.
+ * Returns NaN, and leaves the outputs untouched, if the memory for the
+ * transforms could not be allocated. */
+uint32_t ising_radial_bins(const ising_world* world);
+double ising_correlation(const ising_world* world, double* structure_factor,
+                         double* radial, double* domain_length);
+
+/* Each world has a joint (E, M) histogram for reweighting (histogram.h,
+ * reweight.cpp). Reset starts it over at the current temperature; sample
+ * adds the current state and returns the number of samples; save writes it
+ * and returns 0 on failure. The histogram only holds samples at one
+ * temperature, so ising_set_temp() refuses to change the temperature while
+ * it holds any: save it if needed and reset it first. */
+void ising_histogram_reset(ising_world* world);
+uint64_t ising_histogram_sample(ising_world* world);
+int ising_histogram_save(const ising_world* world, const char* filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ISING_API_H */
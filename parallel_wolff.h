@@ -0,0 +1,327 @@
+#pragma once
+#include <world.h>
+#include <thread_pool.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Wolff cluster updates of a World, with the growth and the flip of large
+// clusters spread over several threads.
+//
+// A cluster is grown depth first on the calling thread until it has
+// threshold sites. Critical clusters are deep and thin: one breadth first
+// level holds only a few hundred sites even when the cluster covers
+// millions, so the work is not split by level. Instead every thread keeps
+// growing from its own stack of sites whose neighbours are still to be
+// examined, without any barrier. A thread that runs out takes a chunk from
+// a shared pool, which the busy threads refill with half of their stack
+// whenever some thread is waiting. The growth ends when all threads are
+// waiting and the pool is empty. Sites are claimed with a compare-and-swap
+// on their visited mark, so that every site joins the cluster once, and
+// each thread flips the sites it claimed.
+//
+// Each bond from the cluster to a site with the same spin is still tested
+// once, with the same probability p = 1 - exp(-2 beta), so the clusters
+// have the same distribution as in World::update_wolff; only which thread
+// adds a site, and so the sequence of random numbers, depends on the
+// scheduling.
+class ParallelWolff
+{
+    // Sites still to be grown from, and sites claimed, by one thread
+    struct Local
+    {
+        std::vector<uint32_t> stack;
+        std::vector<uint32_t> cluster;
+    };
+
+    static const size_t min_share = 8; // smallest stack that is split
+
+    std::unique_ptr<ThreadPool> pool_;
+    int seed_;
+    uint32_t threshold_;
+    std::vector<std::mt19937> generators_;  // one per thread
+    std::vector<Local> locals_;             // one per thread
+    std::unique_ptr<std::atomic<uint8_t>[]> visited_;
+    uint32_t sites_;
+
+    // Work shared between the threads while a cluster grows in parallel
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::vector<std::vector<uint32_t>> shared_;
+    std::atomic<unsigned> idle_;            // threads waiting for work
+    bool done_;                             // guarded by mutex_
+    std::atomic<bool> failed_;              // a thread ran out of memory
+
+    // State of the cluster being grown
+    int8_t* spins_;
+    uint32_t rows_;
+    uint32_t cols_;
+    int8_t spin_;
+    double p_;
+
+    // Add the neighbours of site to the cluster with probability p if they
+    // have its spin and are not yet in it.
+    void grow(uint32_t site, std::uniform_real_distribution<double>& dist,
+              std::mt19937& generator, Local& local)
+    {
+        uint32_t row = site / cols_;
+        uint32_t col = site % cols_;
+        uint32_t neighbours[] = {((row + 1) % rows_) * cols_ + col,
+                                 ((row - 1 + rows_) % rows_) * cols_ + col,
+                                 row * cols_ + (col + 1) % cols_,
+                                 row * cols_ + (col - 1 + cols_) % cols_};
+        for (auto l : neighbours)
+        {
+            if (spins_[l] == spin_ and
+                visited_[l].load(std::memory_order_relaxed) == 0 and
+                dist(generator) < p_)
+            {
+                uint8_t expected = 0;
+                if (visited_[l].compare_exchange_strong(expected, 1, std::memory_order_relaxed))
+                {
+                    local.cluster.push_back(l);
+                    local.stack.push_back(l);
+                }
+            }
+        }
+    }
+
+    // Move the top half of the stack to the shared pool
+    void share(Local& local)
+    {
+        size_t keep = local.stack.size() / 2;
+        std::vector<uint32_t> chunk(local.stack.begin() + keep, local.stack.end());
+        local.stack.resize(keep);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shared_.push_back(std::move(chunk));
+        }
+        work_available_.notify_one();
+    }
+
+    // Wait for a chunk of the shared pool. Returns false when the cluster
+    // is complete, or the growth failed.
+    bool take(Local& local)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            if (done_ or failed_)
+            {
+                return false;
+            }
+            if (not shared_.empty())
+            {
+                local.stack = std::move(shared_.back());
+                shared_.pop_back();
+                return true;
+            }
+            if (++idle_ == pool_->size())
+            {
+                done_ = true;
+                work_available_.notify_all();
+                return false;
+            }
+            work_available_.wait(lock);
+            idle_--;
+        }
+    }
+
+    void fail()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            failed_ = true;
+        }
+        work_available_.notify_all();
+    }
+
+    void work(unsigned thread)
+    {
+        Local& local = locals_[thread];
+        std::uniform_real_distribution<double> dist;
+        try
+        {
+            do
+            {
+                while (not local.stack.empty() and not failed_.load(std::memory_order_relaxed))
+                {
+                    uint32_t site = local.stack.back();
+                    local.stack.pop_back();
+                    grow(site, dist, generators_[thread], local);
+                    if (idle_.load(std::memory_order_relaxed) > 0 and
+                        local.stack.size() >= min_share)
+                    {
+                        share(local);
+                    }
+                }
+            } while (take(local));
+        }
+        catch (const std::bad_alloc&)
+        {
+            fail();
+        }
+    }
+
+    // Grow a cluster from a random site and flip it. Throws std::bad_alloc,
+    // or returns false if a thread ran out of memory; the cluster is then
+    // not flipped.
+    bool update_cluster(std::uniform_int_distribution<uint32_t>& site_picker)
+    {
+        for (auto& local : locals_)
+        {
+            local.stack.clear();
+            local.cluster.clear();
+        }
+        Local& first = locals_[0];
+        std::uniform_real_distribution<double> dist;
+        uint32_t seed = site_picker(generators_[0]);
+        spin_ = spins_[seed];
+        visited_[seed].store(1, std::memory_order_relaxed);
+        first.cluster.push_back(seed);
+        first.stack.push_back(seed);
+
+        while (not first.stack.empty() and
+               (first.cluster.size() < threshold_ or pool_->size() == 1))
+        {
+            uint32_t site = first.stack.back();
+            first.stack.pop_back();
+            grow(site, dist, generators_[0], first);
+        }
+
+        bool parallel = not first.stack.empty();
+        if (parallel)
+        {
+            // start every thread with a share of the stack
+            unsigned threads = pool_->size();
+            size_t size = first.stack.size();
+            shared_.clear();
+            for (unsigned t = 1; t < threads; t++)
+            {
+                size_t from = size * t / threads;
+                size_t to = size * (t + 1) / threads;
+                if (from < to)
+                {
+                    shared_.emplace_back(first.stack.begin() + from, first.stack.begin() + to);
+                }
+            }
+            first.stack.resize(size / threads);
+            idle_ = 0;
+            done_ = false;
+            failed_ = false;
+            pool_->run([this](unsigned thread) { work(thread); });
+            if (failed_)
+            {
+                return false;
+            }
+        }
+
+        // flip the cluster and clear its visited marks for the next one
+        auto flip = [this](unsigned thread)
+        {
+            for (auto site : locals_[thread].cluster)
+            {
+                spins_[site] = -spin_;
+                visited_[site].store(0, std::memory_order_relaxed);
+            }
+        };
+        if (parallel)
+        {
+            pool_->run(flip);
+        }
+        else
+        {
+            flip(0);
+        }
+        return true;
+    }
+
+public:
+    // threads == 0 uses all hardware threads.
+    explicit ParallelWolff(int seed=0, unsigned threads=0, uint32_t threshold=4096)
+            : seed_(seed), threshold_(threshold), sites_(0), idle_(0), done_(false),
+              failed_(false), spins_(nullptr), rows_(0), cols_(0), spin_(0), p_(0)
+    {
+        set_threads(threads);
+    }
+
+    unsigned threads() const { return pool_->size(); }
+
+    // Resize the pool; threads == 0 uses all hardware threads. The random
+    // generators of the threads are kept, and only new threads get freshly
+    // seeded ones, so that no random sequence is ever used twice. Throws
+    // std::system_error if the threads cannot be started, and leaves the
+    // pool as it was.
+    void set_threads(unsigned threads)
+    {
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (pool_ and pool_->size() == threads)
+        {
+            return;
+        }
+        while (generators_.size() < threads)
+        {
+            // World uses seed, seed + 1
+            generators_.emplace_back(seed_ + 2 + generators_.size());
+        }
+        if (locals_.size() < threads)
+        {
+            locals_.resize(threads);
+        }
+        pool_.reset(new ThreadPool(threads));
+    }
+
+    // Returns the number of clusters flipped, which is less than n only if
+    // memory ran out. The cluster that was being grown is then discarded,
+    // and the state stays consistent for later updates.
+    uint32_t update(World& world, uint32_t n=1)
+    {
+        rows_ = world.getRows();
+        cols_ = world.getCols();
+        if (sites_ != rows_ * cols_)
+        {
+            visited_.reset(new std::atomic<uint8_t>[rows_ * cols_]);
+            sites_ = rows_ * cols_;
+            for (uint32_t i = 0; i < sites_; i++)
+            {
+                visited_[i].store(0, std::memory_order_relaxed);
+            }
+        }
+        spins_ = &world.data()[0];
+        p_ = 1.0 - std::exp(-2.0 / world.get_temp());
+        std::uniform_int_distribution<uint32_t> site_picker(0, sites_ - 1);
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            bool flipped = false;
+            try
+            {
+                flipped = update_cluster(site_picker);
+            }
+            catch (const std::bad_alloc&)
+            {
+            }
+            if (not flipped)
+            {
+                // Marks of the unfinished cluster may be set anywhere
+                for (uint32_t j = 0; j < sites_; j++)
+                {
+                    visited_[j].store(0, std::memory_order_relaxed);
+                }
+                return i;
+            }
+        }
+        return n;
+    }
+};
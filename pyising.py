@@ -0,0 +1,180 @@
+#! /usr/bin/env python3
+"""Python bindings for libising.so (build it with `make libising.so`).
+
+The lattice is exposed as a NumPy int8 array of shape (rows, cols) that
+shares its memory with the simulation: updates are visible immediately and
+no copy is made. The calls go through ctypes, which releases the GIL while
+the library runs, so other Python threads keep running during sweeps.
+
+    import pyising
+    w = pyising.World(512, 512, temp=2.269, seed=1)
+    w.init(0.5)
+    w.update_wolff(100)
+    print(w.spins.mean(), w.net_magnetization())
+"""
+
+import ctypes
+import math
+import os
+
+import numpy as np
+
+_API_VERSION = 7
+_NO_THREADS = -1  # ISING_NO_THREADS
+
+
+def _load(path=None):
+    if path is None:
+        path = os.environ.get(
+            "ISING_LIB",
+            os.path.join(os.path.dirname(os.path.abspath(__file__)), "libising.so"))
+    lib = ctypes.CDLL(path)  # CDLL (not PyDLL) calls release the GIL
+
+    world_p = ctypes.c_void_p
+    double_p = ctypes.POINTER(ctypes.c_double)
+    signatures = {
+        "ising_api_version": (ctypes.c_int, []),
+        "ising_create": (world_p, [ctypes.c_uint32, ctypes.c_uint32,
+                                   ctypes.c_double, ctypes.c_int]),
+        "ising_destroy": (None, [world_p]),
+        "ising_init": (None, [world_p, ctypes.c_double, ctypes.c_int]),
+        "ising_rows": (ctypes.c_uint32, [world_p]),
+        "ising_cols": (ctypes.c_uint32, [world_p]),
+        "ising_data": (ctypes.POINTER(ctypes.c_int8), [world_p]),
+        "ising_set_temp": (ctypes.c_int, [world_p, ctypes.c_double]),
+        "ising_get_temp": (ctypes.c_double, [world_p]),
+        "ising_net_magnetization": (ctypes.c_double, [world_p]),
+        "ising_magnetization": (ctypes.c_int64, [world_p]),
+        "ising_energy": (ctypes.c_int64, [world_p]),
+        "ising_update_metropolis": (ctypes.c_uint32, [world_p, ctypes.c_uint32]),
+        "ising_update_wolff": (ctypes.c_uint32, [world_p, ctypes.c_uint32]),
+        "ising_update_wolff_parallel": (ctypes.c_int64, [world_p, ctypes.c_uint32,
+                                                         ctypes.c_uint]),
+        "ising_histogram_reset": (None, [world_p]),
+        "ising_histogram_sample": (ctypes.c_uint64, [world_p]),
+        "ising_histogram_save": (ctypes.c_int, [world_p, ctypes.c_char_p]),
+        "ising_radial_bins": (ctypes.c_uint32, [world_p]),
+        "ising_correlation": (ctypes.c_double, [world_p, double_p, double_p, double_p]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        func = getattr(lib, name)
+        func.restype = restype
+        func.argtypes = argtypes
+
+    if lib.ising_api_version() < _API_VERSION:
+        raise ImportError("%s has API version %d, expected at least %d"
+                          % (path, lib.ising_api_version(), _API_VERSION))
+    return lib
+
+
+_lib = _load()
+
+
+class World:
+    """A periodic lattice of spins, simulated by libising."""
+
+    def __init__(self, rows, cols, temp=1.0, seed=0):
+        self._handle = _lib.ising_create(rows, cols, temp, seed)
+        if not self._handle:
+            raise MemoryError("could not create a %dx%d world" % (rows, cols))
+        self._shape = (rows, cols)
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            _lib.ising_destroy(self._handle)
+            self._handle = None
+
+    @property
+    def spins(self):
+        """Writable (rows, cols) int8 view of the lattice (no copy)."""
+        rows, cols = self._shape
+        buf = (ctypes.c_int8 * (rows * cols)).from_address(
+            ctypes.addressof(_lib.ising_data(self._handle).contents))
+        # The view keeps the world alive, but not the other way around, so
+        # that the world is freed as soon as neither is referenced.
+        buf._owner = self
+        return np.frombuffer(buf, dtype=np.int8).reshape(rows, cols)
+
+    @property
+    def shape(self):
+        return self._shape
+
+    @property
+    def temp(self):
+        return _lib.ising_get_temp(self._handle)
+
+    @temp.setter
+    def temp(self, temp):
+        """Refused while the histogram holds samples, which are only valid at
+        one temperature: histogram_save() and histogram_reset() first."""
+        if not _lib.ising_set_temp(self._handle, temp):
+            raise RuntimeError("the histogram holds samples at temperature %g; "
+                               "save and reset it before changing the temperature"
+                               % self.temp)
+
+    def init(self, fraction=0.5, seed=0):
+        _lib.ising_init(self._handle, fraction, seed)
+
+    def net_magnetization(self):
+        return _lib.ising_net_magnetization(self._handle)
+
+    def magnetization(self):
+        """Total magnetization, the sum of the spins."""
+        return _lib.ising_magnetization(self._handle)
+
+    def energy(self):
+        """Total energy, minus the sum of s_i s_j over neighbouring pairs."""
+        return _lib.ising_energy(self._handle)
+
+    def histogram_reset(self):
+        """Start a new (E, M) histogram at the current temperature."""
+        _lib.ising_histogram_reset(self._handle)
+
+    def histogram_sample(self):
+        """Add the current state to the histogram; returns the sample count."""
+        return _lib.ising_histogram_sample(self._handle)
+
+    def histogram_save(self, filename):
+        """Write the histogram in the format read by the reweight tool."""
+        if not _lib.ising_histogram_save(self._handle, os.fsencode(filename)):
+            raise IOError("could not write %s" % filename)
+
+    def update_metropolis(self, n=1):
+        return _lib.ising_update_metropolis(self._handle, n)
+
+    def update_wolff(self, n=1):
+        return _lib.ising_update_wolff(self._handle, n)
+
+    def update_wolff_parallel(self, n=1, threads=0):
+        """Wolff updates with large clusters handled by several threads
+        (all hardware threads if threads is 0, at most 4 times that many)."""
+        updated = _lib.ising_update_wolff_parallel(self._handle, n, threads)
+        if updated == _NO_THREADS:
+            raise RuntimeError("could not start %d threads" % threads)
+        if updated < n:
+            raise MemoryError("out of memory after %d of %d clusters" % (updated, n))
+        return updated
+
+    def correlation(self):
+        """Returns (S, G, length, domain_length), with S the structure factor
+        for the wave vectors 2 pi (i / rows, j / cols), j <= cols / 2, as an
+        array of shape (rows, cols // 2 + 1), G the radially averaged
+        connected correlation function for r = 0, 1, ..., length 2 pi / <|k|>
+        with |k| weighted by S, and domain_length where G drops to G[0] / 2.
+
+        The second moment correlation length follows from S averaged over
+        many states: with L = max(rows, cols), k_min = 2 pi / L and S(k_min)
+        the mean of S over the smallest nonzero wave vectors along L,
+            xi = sqrt(<S[0, 0]> / <S(k_min)> - 1) / (2 sin(k_min / 2))."""
+        rows, cols = self.shape
+        S = np.empty((rows, cols // 2 + 1))
+        G = np.empty(_lib.ising_radial_bins(self._handle))
+        domain_length = ctypes.c_double()
+        length = _lib.ising_correlation(
+            self._handle,
+            S.ctypes.data_as(ctypes.POINTER(ctypes.c_double)),
+            G.ctypes.data_as(ctypes.POINTER(ctypes.c_double)),
+            ctypes.byref(domain_length))
+        if math.isnan(length):
+            raise MemoryError("could not allocate the correlation transforms")
+        return S, G, length, domain_length.value
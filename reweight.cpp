@@ -0,0 +1,195 @@
+// g++ --std=c++14 -I. -o reweight -O3 reweight.cpp
+//
+// Ferrenberg-Swendsen reweighting of (E, M) histograms written by ising (see
+// histogram.h): the observables are estimated at a range of temperatures
+// from one run (single histogram) or several runs at different temperatures
+// of the same lattice (multi-histogram). The estimates are only reliable
+// near the temperatures at which the histograms were sampled.
+#include <histogram.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+// log(exp(a) + exp(b)) without overflow
+static double log_add(double a, double b)
+{
+    if (a < b)
+    {
+        swap(a, b);
+    }
+    return b == -INFINITY ? a : a + log1p(exp(b - a));
+}
+
+class Reweighting
+{
+    struct State
+    {
+        int64_t energy;
+        int64_t magnetization;
+        double log_count;   // log of the count summed over all runs
+        double log_weight;  // log of the estimated number of states
+    };
+
+    vector<State> states_;
+    vector<double> betas_;
+    vector<double> log_samples_;
+    vector<double> free_energies_; // beta_i F_i, with the first fixed to 0
+    uint32_t sites_;
+
+    // log of sum_i n_i exp(f_i - beta_i E)
+    double log_denominator(int64_t energy) const
+    {
+        double result = -INFINITY;
+        for (size_t i = 0; i < betas_.size(); i++)
+        {
+            result = log_add(result, log_samples_[i] + free_energies_[i] - betas_[i] * energy);
+        }
+        return result;
+    }
+
+public:
+    Reweighting(const vector<EMHistogram>& histograms)
+            : sites_(histograms[0].getRows() * histograms[0].getCols())
+    {
+        EMHistogram::Counts total;
+        for (auto& histogram : histograms)
+        {
+            betas_.push_back(1. / histogram.get_temp());
+            log_samples_.push_back(log(double(histogram.samples())));
+            for (auto& entry : histogram.counts())
+            {
+                total[entry.first] += entry.second;
+            }
+        }
+        free_energies_.assign(histograms.size(), 0.);
+        for (auto& entry : total)
+        {
+            states_.push_back(State{entry.first.first, entry.first.second,
+                                    log(double(entry.second)), 0.});
+        }
+    }
+
+    // Solves the multi-histogram equations
+    //     g(E, M) = H(E, M) / sum_i n_i exp(f_i - beta_i E)
+    //     exp(-f_i) = sum_(E, M) g(E, M) exp(-beta_i E)
+    // by iteration. For a single histogram the first equation suffices.
+    // Returns the number of iterations, or -1 if it did not converge.
+    int solve(double tolerance=1e-10, int max_iterations=100000)
+    {
+        for (int iteration = 1; iteration <= max_iterations; iteration++)
+        {
+            for (auto& state : states_)
+            {
+                state.log_weight = state.log_count - log_denominator(state.energy);
+            }
+            if (betas_.size() == 1)
+            {
+                return iteration;
+            }
+            double change = 0;
+            vector<double> updated(betas_.size());
+            for (size_t i = 0; i < betas_.size(); i++)
+            {
+                double log_z = -INFINITY;
+                for (auto& state : states_)
+                {
+                    log_z = log_add(log_z, state.log_weight - betas_[i] * state.energy);
+                }
+                updated[i] = -log_z;
+            }
+            for (size_t i = 0; i < betas_.size(); i++)
+            {
+                updated[i] -= updated[0];
+                change = max(change, fabs(updated[i] - free_energies_[i]));
+            }
+            free_energies_ = updated;
+            if (change < tolerance)
+            {
+                return iteration;
+            }
+        }
+        return -1;
+    }
+
+    // Prints temp, energy, specific heat, |magnetization|, susceptibility
+    // (all per site) and the Binder cumulant at the given temperature.
+    void print_observables(double temp) const
+    {
+        double beta = 1. / temp;
+        double log_max = -INFINITY;
+        for (auto& state : states_)
+        {
+            log_max = max(log_max, state.log_weight - beta * state.energy);
+        }
+        // Moments relative to the largest term, to stay within range
+        double z = 0, e1 = 0, e2 = 0, m1 = 0, m2 = 0, m4 = 0;
+        for (auto& state : states_)
+        {
+            double w = exp(state.log_weight - beta * state.energy - log_max);
+            double e = state.energy;
+            double m = fabs(double(state.magnetization));
+            z += w;
+            e1 += w * e;
+            e2 += w * e * e;
+            m1 += w * m;
+            m2 += w * m * m;
+            m4 += w * m * m * m * m;
+        }
+        e1 /= z; e2 /= z; m1 /= z; m2 /= z; m4 /= z;
+        printf("%.6f %.8f %.8f %.8f %.8f %.8f\n", temp,
+               e1 / sites_,
+               beta * beta * (e2 - e1 * e1) / sites_,
+               m1 / sites_,
+               beta * (m2 - m1 * m1) / sites_,
+               1 - m4 / (3 * m2 * m2));
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc < 5 or argv[1][0] == 'h' or argv[1][0] == '?')
+    {
+        printf("Usage: %s <min temp> <max temp> <points> <histogram> [histogram ...]\n",
+               argv[0]);
+        exit(0);
+    }
+
+    double min_temp = atof(argv[1]);
+    double max_temp = atof(argv[2]);
+    int points = max(atoi(argv[3]), 1);
+
+    vector<EMHistogram> histograms(argc - 4);
+    for (int i = 4; i < argc; i++)
+    {
+        auto& histogram = histograms[i - 4];
+        if (not histogram.load(argv[i]) or histogram.samples() == 0)
+        {
+            fprintf(stderr, "Cannot read histogram %s\n", argv[i]);
+            exit(1);
+        }
+        if (histogram.getRows() != histograms[0].getRows() or
+            histogram.getCols() != histograms[0].getCols())
+        {
+            fprintf(stderr, "Histogram %s is for a different lattice size\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    Reweighting reweighting(histograms);
+    if (reweighting.solve() < 0)
+    {
+        fprintf(stderr, "Warning: the multi-histogram iteration did not converge\n");
+    }
+
+    printf("# temp energy specific_heat abs_magnetization susceptibility binder\n");
+    for (int i = 0; i < points; i++)
+    {
+        double temp = points == 1 ? min_temp :
+            min_temp + (max_temp - min_temp) * i / (points - 1);
+        reweighting.print_observables(temp);
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that repeatedly run the same kind of job
+// together: run(job) calls job(i) for every thread index i < size(), with
+// index 0 on the calling thread, and returns when all of them are done.
+// If a call throws, run rethrows the first exception, but only after all
+// threads have finished the job.
+class ThreadPool
+{
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    const std::function<void(unsigned)>* job_;
+    uint64_t round_;
+    unsigned pending_;
+    bool stop_;
+    std::exception_ptr error_;
+
+    void work(unsigned index)
+    {
+        uint64_t round = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            start_.wait(lock, [&]() { return stop_ or round_ != round; });
+            if (stop_)
+            {
+                return;
+            }
+            round = round_;
+            auto job = job_;
+            lock.unlock();
+            std::exception_ptr error;
+            try
+            {
+                (*job)(index);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            lock.lock();
+            if (error and not error_)
+            {
+                error_ = error;
+            }
+            if (--pending_ == 0)
+            {
+                done_.notify_one();
+            }
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        start_.notify_all();
+        for (auto& thread : threads_)
+        {
+            thread.join();
+        }
+    }
+
+public:
+    // size is the total number of threads, including the calling one.
+    explicit ThreadPool(unsigned size)
+            : job_(nullptr), round_(0), pending_(0), stop_(false)
+    {
+        try
+        {
+            for (unsigned i = 1; i < size; i++)
+            {
+                threads_.emplace_back(&ThreadPool::work, this, i);
+            }
+        }
+        catch (...)
+        {
+            // joinable threads must not be destroyed
+            stop();
+            throw;
+        }
+    }
+
+    ~ThreadPool()
+    {
+        stop();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return threads_.size() + 1; }
+
+    void run(const std::function<void(unsigned)>& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &job;
+            pending_ = threads_.size();
+            round_++;
+        }
+        start_.notify_all();
+        std::exception_ptr error;
+        try
+        {
+            job(0);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        // The other threads use job until they are done
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return pending_ == 0; });
+        if (not error)
+        {
+            error = error_;
+        }
+        error_ = nullptr;
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+};
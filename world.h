@@ -0,0 +1,236 @@
+#pragma once
+#include <matrix.h>
+#include <random>
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+
+class World: public Matrix
+{
+    double beta_;
+    std::mt19937 generator_;
+    std::mt19937 generator2_;
+    std::uniform_int_distribution<uint32_t> row_picker_;
+    std::uniform_int_distribution<uint32_t> col_picker_;
+    std::uniform_real_distribution<double> dist_;
+    std::function<double()> rnd;
+    std::function<uint32_t()> rnd_row;
+    std::function<uint32_t()> rnd_col;
+    
+    struct Point
+    {
+        uint32_t row;
+        uint32_t col;
+    };
+
+    struct point_hash {
+        size_t operator()(const Point& p) const {
+            return p.row*31 + p.col;
+        }
+    };
+
+    struct point_equal {
+        bool operator()(const Point& p, const Point& q) const {
+            return p.row == q.row and p.col == q.col;
+        }
+    };
+
+    struct Neighbours
+    {
+        const World& world;
+        std::vector<Point> points;
+        Neighbours(const World& world, const Point& point)
+                : world(world)
+        {
+            auto row = point.row;
+            auto col = point.col;
+            auto R = world.getRows();
+            auto C = world.getCols();
+            points = {Point{(row + 1) % R, col},
+                      Point{(row - 1 + R) % R, col},
+                      Point{row, (col + 1) % C},
+                      Point{row, (col - 1 + C) % C}};
+        }
+    };
+    
+public:
+    using Matrix::Matrix; // c++11: matrix constructors
+    World(uint32_t rows, uint32_t cols, double temp=1.0, int seed=0)
+            : Matrix(rows, cols), beta_(1./temp),
+              generator_(), generator2_(),
+              row_picker_(0, rows - 1), col_picker_(0, cols - 1), dist_()
+    {
+        generator_.seed(seed);
+        generator2_.seed(seed + 1);
+        rnd = std::bind(dist_, generator_);
+        rnd_row = std::bind(row_picker_, generator_);
+        rnd_col = std::bind(col_picker_, generator2_);
+    }
+
+    int8_t getp(Point p) const
+    {
+        return get(p.row, p.col);
+    }
+    
+    void setp(Point p, int8_t val)
+    {
+        set(p.row, p.col, val);
+    }
+    
+    void init(double fraction, int seed=0)
+    {
+        std::bernoulli_distribution dist(fraction);
+        generator_.seed(seed);
+        auto rnd_init = std::bind(dist, generator_);
+        std::generate(std::begin(data()), std::end(data()), [&rnd_init]() { return rnd_init() ? 1 : -1; });
+    }
+
+    void set_temp(double temp)
+    {
+        beta_ = 1./temp;
+    }
+
+    double get_temp() const
+    {
+        return 1./beta_;
+    }
+
+    // Whether set_temp(temp) would leave the temperature as it is
+    bool same_temp(double temp) const
+    {
+        return beta_ == 1./temp;
+    }
+    
+    // Average magnetization
+    double net_magnetization() const
+    {
+        // cannot use data().sum(), because the data type cannot hold the sum in general
+        return std::accumulate(std::begin(data()), std::end(data()), 0.) / // default operator is plus<T>
+            (getRows() * getCols());
+    }
+
+    // Total magnetization M, the sum of the spins
+    int64_t magnetization() const
+    {
+        return std::accumulate(std::begin(data()), std::end(data()), int64_t(0));
+    }
+
+    // Total energy E = -sum of s_i s_j over neighbouring pairs (J = 1)
+    int64_t energy() const
+    {
+        auto R = getRows();
+        auto C = getCols();
+        int64_t sum = 0;
+        for (uint32_t r = 0; r < R; r++)
+        {
+            for (uint32_t c = 0; c < C; c++)
+            {
+                sum += get(r, c) * (get((r + 1) % R, c) + get(r, (c + 1) % C));
+            }
+        }
+        return -sum;
+    }
+
+    int neighbour_sum(int row, int col) const
+    {
+        auto R = getRows();
+        auto C = getCols();
+        return get((row + 1) % R, col) +
+            get((row - 1 + R) % R, col) +
+            get(row, (col + 1) % C) +
+            get(row, (col - 1 + C) % C);
+    }
+
+    uint32_t update_metropolis(uint32_t n=1)
+    {
+        uint32_t accepted = 0;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            int row = rnd_row();
+            int col = rnd_col();
+            auto val = get(row, col);
+            double delta_E = 2 * val * neighbour_sum(row, col);
+            // printf("(%d,%d), ΔE = %.1f: ", row, col, delta_E); ///
+            // accept or reject?
+            if (rnd() < std::exp(-beta_ * delta_E))
+            {
+                set(row, col, -val);
+                accepted++;
+                // printf("accepted\n"); ///
+            }
+            else
+            {
+                // printf("rejected\n"); ///
+            }
+        }
+        return accepted;
+    }
+    
+    uint32_t update_wolff(uint32_t n=1)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            // value for p for which rejection rate is 0: full Boltzmann 
+            // statistics are obtained from conditions for cluster growth. 
+            double p = 1.0 - std::exp(-2.0 * beta_);
+            Point k{rnd_row(), rnd_col()};
+            std::vector<Point> frontier{k};
+            std::unordered_set<Point, point_hash, point_equal>cluster({k});
+            while (!frontier.empty())
+            {
+                // choose random element from frontier and remove it
+                std::uniform_int_distribution<uint32_t> point_picker(0, frontier.size() - 1);
+                std::swap(frontier[point_picker(generator_)], frontier.back());
+                auto j = frontier.back();   // this is the random frontier element
+                frontier.pop_back();        // remove from frontier
+                // determine which of its neighbours to add to cluser
+                // (with probability p if it has the same spin)
+                Neighbours j_neighbours(*this, j);
+                for (auto& l : j_neighbours.points)
+                {
+                    // Could leave test that l is in cluster out. What is faster? Check
+                    if (getp(l) == getp(j) and cluster.find(l) == cluster.end() and rnd() < p)
+                    {
+                        // add l to frontier and to cluster
+                        frontier.push_back(l);
+                        cluster.emplace(l);
+                    }   
+                }
+            }
+            // flip all element of the cluster
+            for (auto& j : cluster)
+            {
+                setp(j, -getp(j));
+            }
+        }
+        return n;
+    }
+    
+    void print(const std::string& info) const
+    {
+        uint32_t R = getRows();
+        uint32_t C = getCols();
+        
+        for (uint32_t r = 0; r < R; r++)
+        {
+            for (uint32_t c = 0; c < C; c++)
+            {
+                putchar(get(r,c) == 1 ? 'O' : ' ');
+                //putwchar(get(r,c) == 1 ? u'↑' : u'↓');
+            }
+            if (r != R - 1)
+            {
+                putchar('\n');
+            }
+        }
+        // hide visibility cursor and put cursor at 0,0 
+        printf("%c[?25l%c[%d;%df",0x1B,0x1B,0,0); 
+        std::cout << info << std::flush;
+    }
+};